@@ -1,10 +1,39 @@
 #ifdef DEBUG
+#include <atomic>
+#include <cstdlib>
 #include <format>
 #include <iostream>
+#include <new>
 #endif
 
 #include "App.hpp"
 
+#ifdef DEBUG
+
+// Debug builds count every call to the global `operator new`, both in total
+// and per thread, so that load and per-frame allocations can be reported.
+static std::atomic<uint64_t> totalAllocations = 0;
+static thread_local uint64_t threadAllocations = 0;
+
+void* operator new(std::size_t size) {
+  totalAllocations.fetch_add(1, std::memory_order_relaxed);
+  ++threadAllocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+#endif
+
 namespace Can {
 App::App(std::string fileToOpen) {
   initSDL();
@@ -16,12 +45,19 @@ App::App(std::string fileToOpen) {
   width_ = static_cast<int>(m_mode->w * 0.38);
   height_ = static_cast<int>(m_mode->h * 0.38);
   // If MIDI File
-  viewer = std::make_unique<Can::Viewers::MidiViewer>(
-      Can::Viewers::MidiViewer(fileToOpen, width_, height_));
+#ifdef DEBUG
+  const uint64_t allocs = totalAllocations;
+#endif
+  viewer = std::make_unique<Can::Viewers::MidiViewer>(fileToOpen, width_,
+                                                      height_);
+#ifdef DEBUG
+  loadAllocations_ = totalAllocations - allocs;
+#endif
 
 #ifdef DEBUG
   initTTF();
   std::cout << "Startup time: " << SDL_GetTicks() << "ms" << std::endl;
+  printAllocations();
 #endif
 }
 
@@ -44,7 +80,13 @@ void App::run() {
   auto t = std::thread([this]() {
     while (!shouldQuit_) {
       uint64_t start = SDL_GetTicks();
+#ifdef DEBUG
+      const uint64_t allocs = threadAllocations;
+#endif
       viewer->update();
+#ifdef DEBUG
+      updateAllocations_ += threadAllocations - allocs;
+#endif
       int64_t end = static_cast<int64_t>(SDL_GetTicks() - start);
       int64_t rem = 9 - end;
       if (rem > 0) {
@@ -57,7 +99,13 @@ void App::run() {
     uint64_t start = SDL_GetTicks();
     SDL_PollEvent(&e);
     handleEvent();
+#ifdef DEBUG
+    const uint64_t allocs = threadAllocations;
+#endif
     viewer->render(r);
+#ifdef DEBUG
+    renderAllocations_ += threadAllocations - allocs;
+#endif
 
 #ifdef DEBUG
     drawFps();
@@ -74,6 +122,10 @@ void App::run() {
     }
   }
   t.join();
+
+#ifdef DEBUG
+  printAllocations();
+#endif
 }
 
 void App::handleEvent() {
@@ -114,6 +166,14 @@ void App::initTTF() {
   }
 }
 
+void App::printAllocations() {
+  std::cout << "Load allocations: " << loadAllocations_ << std::endl;
+  std::cout << "Update allocations since load: " << updateAllocations_.load()
+            << std::endl;
+  std::cout << "Render allocations since load: " << renderAllocations_
+            << std::endl;
+}
+
 void App::drawFps() {
   uint64_t interval = 10;
   if (viewer->frameNum % interval == 0) {
@@ -122,7 +182,9 @@ void App::drawFps() {
            static_cast<float>(interval);
     prevTime_ = currT;
   }
-  std::string txt = std::format("{:.2f}", fps_);
+  std::string txt =
+      std::format("{:.2f} (allocs since load: {} update, {} render)", fps_,
+                  updateAllocations_.load(), renderAllocations_);
   auto textSurface =
       TTF_RenderText_Solid(font, txt.data(), txt.size(),
                            SDL_Color{.r = 255, .g = 255, .b = 255, .a = 255});
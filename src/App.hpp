@@ -8,6 +8,7 @@
 
 #ifdef DEBUG
 #include <SDL3_ttf/SDL_ttf.h>
+#include <atomic>
 #endif
 
 namespace Can {
@@ -36,7 +37,14 @@ class App {
 #ifdef DEBUG
   void initTTF();
   void drawFps();
+  void printAllocations();
   TTF_Font* font;
+
+  // Allocations made while loading the viewer, and by all calls to `update()`
+  // and `render()` since. The latter two should stay at zero.
+  uint64_t loadAllocations_ = 0;
+  std::atomic<uint64_t> updateAllocations_ = 0;
+  uint64_t renderAllocations_ = 0;
 #endif
 };
 
@@ -1,5 +1,8 @@
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <cmath>
+#include <thread>
 
 #include "MidiViewer.hpp"
 #include "helper.hpp"
@@ -7,6 +10,16 @@
 namespace Can {
 namespace Viewers {
 
+namespace {
+
+// Whether `event` ends a note, i.e. is a note off or a note on with velocity 0.
+bool isNoteOff(const MidiParser::MIDIEvent& event) {
+  const uint8_t masked = event.status & 0b11110000;
+  return (masked == 0b10010000 && event.data[1] == 0) || masked == 0b10000000;
+}
+
+}  // namespace
+
 MidiViewer::MidiViewer(std::string fileToView, int width, int height)
     : Viewer(fileToView, width, height),
       prevMouseWheel_(0.f),
@@ -14,19 +27,27 @@ MidiViewer::MidiViewer(std::string fileToView, int width, int height)
       xOffset_(0.f),
       xOffsetMax_(0.f),
       mouseAccel_(0.f) {
-  populateNotes();
+  MidiParser::Parser parser;
+  const MidiParser::MidiFile parsed = parser.parse(fileToView_);
+
+  // Decoded notes are only needed until `populateNoteRects()` is done, so they
+  // live in an arena sized by a pre-pass and released in one go afterwards.
+  const EventCounts counts = countEvents(parsed);
+  std::pmr::monotonic_buffer_resource arena(counts.arenaBytes());
+  Notes notes(&arena);
+  populateNotes(parsed, counts, &arena, notes);
 
   // calculate bounds of viewer based on midi data
-  for (size_t i = 0; i < allNotes_.size; i++) {
-    auto k = allNotes_.key[i];
+  for (size_t i = 0; i < notes.size; i++) {
+    auto k = notes.key[i];
     if (k < lowestKey_) {
       lowestKey_ = k;
     }
     if (k > highestKey_) {
       highestKey_ = k;
     }
-    if (allNotes_.end[i] > totalMillis_) {
-      totalMillis_ = allNotes_.end[i];
+    if (notes.end[i] > totalMillis_) {
+      totalMillis_ = notes.end[i];
     }
   }
   inclusiveNoteRange_ = highestKey_ - lowestKey_ + 1;
@@ -46,9 +67,14 @@ MidiViewer::MidiViewer(std::string fileToView, int width, int height)
   mouseAccelScaling_ = trackLengthNormalized * 0.005f;
   mouseAccelDamping_ = trackLengthNormalized / 10000.f;
 
-  populateNoteRects();
+  populateNoteRects(notes);
+  for (auto& buffer : drawnRects_) {
+    buffer.rect.resize(refs_.size);
+    buffer.col.resize(refs_.size);
+  }
 
   // generate rects for drawing grid
+  gridRects_.reserve(inclusiveNoteRange_);
   for (auto i = 0u; i < inclusiveNoteRange_; i++) {
     gridRects_.push_back(
         {.x = 0,
@@ -65,6 +91,7 @@ MidiViewer::MidiViewer(std::string fileToView, int width, int height)
       static_cast<unsigned int>(std::floor(totalMillis_ / interval));
   numTicks = std::max(
       {numTicks, static_cast<unsigned int>(std::floor(pageSize_ / interval))});
+  gridTicks_.reserve(numTicks);
   for (auto i = 1u; i <= numTicks; i++) {
     float x = helper::map(static_cast<float>(i) * interval, 0, pageSize_, 0,
                           widthf_, false);
@@ -79,19 +106,21 @@ void MidiViewer::update() {
   xOffset_ = std::clamp(xOffset_, xOffsetMin_, xOffsetMax_);
 
   size_t writeBuffer = 1 - currentBuffer;
-  drawnRects_[writeBuffer].clear();
+  Rects& drawn = drawnRects_[writeBuffer];
+  size_t numDrawn = 0;
   for (size_t i = 0; i < refs_.size; i++) {
     float xpos = refs_.rect[i].x + xOffset_;
     float xposEnd = xpos + refs_.rect[i].w;
     if ((xpos > 0 && xpos < widthf_) || (xposEnd > 0 && xposEnd < widthf_)) {
-      drawnRects_[writeBuffer].emplace_back(
-          std::pair{SDL_FRect{.x = xpos,
-                              .y = refs_.rect[i].y,
-                              .w = refs_.rect[i].w,
-                              .h = refs_.rect[i].h},
-                    refs_.col[i]});
+      drawn.rect[numDrawn] = SDL_FRect{.x = xpos,
+                                       .y = refs_.rect[i].y,
+                                       .w = refs_.rect[i].w,
+                                       .h = refs_.rect[i].h};
+      drawn.col[numDrawn] = refs_.col[i];
+      ++numDrawn;
     }
   }
+  drawn.size = numDrawn;
   currentBuffer = writeBuffer;
 }
 
@@ -130,10 +159,11 @@ void MidiViewer::drawTimeTicks(SDL_Renderer* renderer) {
 }
 
 void MidiViewer::drawMIDINotes(SDL_Renderer* renderer) {
-  for (const auto& p : drawnRects_[currentBuffer]) {
-    const SDL_Color& col = std::get<1>(p);
+  const Rects& drawn = drawnRects_[currentBuffer];
+  for (size_t i = 0; i < drawn.size; i++) {
+    const SDL_Color& col = drawn.col[i];
     SDL_SetRenderDrawColor(renderer, col.r, col.g, col.b, col.a);
-    SDL_RenderFillRect(renderer, &std::get<0>(p));
+    SDL_RenderFillRect(renderer, &drawn.rect[i]);
   }
 };
 
@@ -150,22 +180,68 @@ void MidiViewer::onMouseDown(const SDL_Event& event) {
   mouseAccel_ = 0.f;
 };
 
-void MidiViewer::populateNotes() {
+size_t MidiViewer::EventCounts::arenaBytes() const {
+  const size_t noteBytes = 2 * sizeof(uint8_t) + 2 * sizeof(float);
+  const size_t tempoBytes = sizeof(uint32_t) + sizeof(float);
+  const size_t trackBytes = sizeof(size_t) + sizeof(std::thread);
+  // Alignment padding for each of the 8 arrays, and the arena's bookkeeping.
+  const size_t overhead = 9 * alignof(std::max_align_t);
+  return notes * noteBytes + tempos * tempoBytes +
+         notesPerTrack.size() * trackBytes + overhead;
+}
+
+MidiViewer::EventCounts MidiViewer::countEvents(
+    const MidiParser::MidiFile& parsed) {
+  using namespace MidiParser;
+
+  EventCounts counts;
+  counts.notesPerTrack.resize(parsed.tracks.size());
+  for (size_t i = 0; i < parsed.tracks.size(); i++) {
+    for (const TrackEvent& e : parsed.tracks.at(i).events) {
+      if (const MetaEvent* meta = std::get_if<MetaEvent>(&e)) {
+        if (meta->status == 0x51) {  // Set Tempo Event
+          ++counts.tempos;
+        }
+      }
+      if (const MIDIEvent* event = std::get_if<MIDIEvent>(&e)) {
+        if (isNoteOff(*event)) {
+          ++counts.notesPerTrack[i];
+        }
+      }
+    }
+    counts.notes += counts.notesPerTrack[i];
+  }
+  return counts;
+}
+
+void MidiViewer::populateNotes(const MidiParser::MidiFile& parsed,
+                               const EventCounts& counts,
+                               std::pmr::monotonic_buffer_resource* arena,
+                               Notes& notes) {
   using namespace MidiParser;
 
-  Parser parser;
-  MidiFile parsed = parser.parse(fileToView_);
   float tickf = static_cast<float>(parsed.tickDivision);
   size_t numTracks = parsed.tracks.size();
 
-  struct {
-    std::vector<uint32_t> time;
+  struct TempoMap {
+    explicit TempoMap(std::pmr::memory_resource* mem)
+        : time(mem), tempo(mem) {};
+    std::pmr::vector<uint32_t> time;
     // tempo in milliseconds
-    std::vector<float> tempo;
+    std::pmr::vector<float> tempo;
     size_t size = 0;
-  } tempoMap;
+  } tempoMap(arena);
+
+  // Where each track's notes start in `notes`. Tracks are decoded in parallel,
+  // each writing into its own slice.
+  std::pmr::vector<size_t> trackOffsets(numTracks, 0, arena);
+  for (size_t i = 1; i < numTracks; i++) {
+    trackOffsets[i] = trackOffsets[i - 1] + counts.notesPerTrack[i - 1];
+  }
 
   //populate tempoMap
+  tempoMap.time.reserve(counts.tempos);
+  tempoMap.tempo.reserve(counts.tempos);
   for (size_t i = 0; i < numTracks; i++) {
     uint32_t currentTime = 0;
     for (const TrackEvent& e : parsed.tracks.at(i).events) {
@@ -183,99 +259,90 @@ void MidiViewer::populateNotes() {
     }
   }
 
-  std::vector<std::thread> threads;
-  struct SOA {
-    std::vector<uint8_t> key;
-    std::vector<uint8_t> vel;
-    std::vector<float> start;
-    std::vector<float> end;
-    size_t size = 0;
-  };
-  std::vector<SOA> tempNotes;
-  tempNotes.resize(numTracks);
+  notes.key.resize(counts.notes);
+  notes.vel.resize(counts.notes);
+  notes.start.resize(counts.notes);
+  notes.end.resize(counts.notes);
+  notes.size = counts.notes;
+
+  std::pmr::vector<std::thread> threads(arena);
+  threads.reserve(numTracks);
   for (size_t i = 0; i < numTracks; i++) {
-    threads.emplace_back(
-        std::thread([i, parsed, tempoMap, tickf, &tempNotes]() mutable {
-          std::array<uint32_t, 127> noteOn;
-          std::array<uint8_t, 127> noteVel;
-          uint32_t currentTime = 0;
-          float currentTempo = 0;
-          for (const TrackEvent& e : parsed.tracks.at(i).events) {
-            if (const MIDIEvent* event = std::get_if<MIDIEvent>(&e)) {
-              currentTime += event->deltaTime;
-              // get currentTempo;
-              for (size_t i = 0; i < tempoMap.size; i++) {
-                if (currentTime >= tempoMap.time[i]) {
-                  currentTempo = tempoMap.tempo[i];
-                }
-              }
-              const uint8_t masked = event->status & 0b11110000;
-              const bool hasNoteOnStatus = masked == 0b10010000;
-              const bool hasNoteOffStatus = masked == 0b10000000;
-              if (!(hasNoteOnStatus || hasNoteOffStatus)) {
-                continue;
-              }
-              const uint8_t key = event->data[0];
-              const uint8_t velocity = event->data[1];
-              const bool isNoteOn = hasNoteOnStatus && velocity != 0;
-              const bool isNoteOff =
-                  (hasNoteOnStatus && velocity == 0) || hasNoteOffStatus;
-              if (isNoteOn) {
-                noteOn[key] = currentTime;
-                noteVel[key] = velocity;
-              }
-              const float start =
-                  static_cast<float>(noteOn[key]) / tickf * currentTempo;
-              const float end =
-                  static_cast<float>(currentTime) / tickf * currentTempo;
-              if (isNoteOff) {
-                tempNotes[i].key.emplace_back(key);
-                tempNotes[i].vel.emplace_back(noteVel[key]);
-                tempNotes[i].start.emplace_back(start);
-                tempNotes[i].end.emplace_back(end);
-                ++tempNotes[i].size;
-              }
-            }
-            if (const MetaEvent* event = std::get_if<MetaEvent>(&e)) {
-              currentTime += event->deltaTime;
+    threads.emplace_back(std::thread([i, offset = trackOffsets[i],
+                                      count = counts.notesPerTrack[i], &parsed,
+                                      &tempoMap, tickf, &notes]() {
+      std::array<uint32_t, 127> noteOn;
+      std::array<uint8_t, 127> noteVel;
+      uint32_t currentTime = 0;
+      float currentTempo = 0;
+      size_t n = offset;
+      for (const TrackEvent& e : parsed.tracks.at(i).events) {
+        if (const MIDIEvent* event = std::get_if<MIDIEvent>(&e)) {
+          currentTime += event->deltaTime;
+          // get currentTempo;
+          for (size_t i = 0; i < tempoMap.size; i++) {
+            if (currentTime >= tempoMap.time[i]) {
+              currentTempo = tempoMap.tempo[i];
             }
           }
-        }));
+          const uint8_t masked = event->status & 0b11110000;
+          const bool hasNoteOnStatus = masked == 0b10010000;
+          const bool hasNoteOffStatus = masked == 0b10000000;
+          if (!(hasNoteOnStatus || hasNoteOffStatus)) {
+            continue;
+          }
+          const uint8_t key = event->data[0];
+          const uint8_t velocity = event->data[1];
+          const bool isNoteOn = hasNoteOnStatus && velocity != 0;
+          if (isNoteOn) {
+            noteOn[key] = currentTime;
+            noteVel[key] = velocity;
+          }
+          const float start =
+              static_cast<float>(noteOn[key]) / tickf * currentTempo;
+          const float end =
+              static_cast<float>(currentTime) / tickf * currentTempo;
+          if (isNoteOff(*event)) {
+            assert(n < offset + count);
+            notes.key[n] = key;
+            notes.vel[n] = noteVel[key];
+            notes.start[n] = start;
+            notes.end[n] = end;
+            ++n;
+          }
+        }
+        if (const MetaEvent* event = std::get_if<MetaEvent>(&e)) {
+          currentTime += event->deltaTime;
+        }
+      }
+      assert(n == offset + count);
+    }));
   }  // end for loop
   for (auto& t : threads) {
     t.join();
   }
-  for (const auto& noteCol : tempNotes) {
-    allNotes_.key.insert(allNotes_.key.end(), noteCol.key.begin(),
-                         noteCol.key.end());
-    allNotes_.vel.insert(allNotes_.vel.end(), noteCol.vel.begin(),
-                         noteCol.vel.end());
-    allNotes_.start.insert(allNotes_.start.end(), noteCol.start.begin(),
-                           noteCol.start.end());
-    allNotes_.end.insert(allNotes_.end.end(), noteCol.end.begin(),
-                         noteCol.end.end());
-    allNotes_.size += noteCol.size;
-  }
 }
 
-void MidiViewer::populateNoteRects() {
-  for (size_t i = 0; i < allNotes_.size; i++) {
+void MidiViewer::populateNoteRects(const Notes& notes) {
+  refs_.rect.reserve(notes.size);
+  refs_.col.reserve(notes.size);
+  for (size_t i = 0; i < notes.size; i++) {
     refs_.rect.emplace_back(
-        SDL_FRect{.x = helper::map(allNotes_.start[i], 0.f, pageSize_, 0.f,
+        SDL_FRect{.x = helper::map(notes.start[i], 0.f, pageSize_, 0.f,
                                    widthf_, false) +
                        padding_,
-                  .y = helper::map(static_cast<float>(allNotes_.key[i]),
+                  .y = helper::map(static_cast<float>(notes.key[i]),
                                    static_cast<float>(lowestKey_),
                                    static_cast<float>(highestKey_),
                                    heightf_ - noteHeight_, 0.f) +
                        padding_,
-                  .w = helper::map(allNotes_.end[i] - allNotes_.start[i], 0.f,
+                  .w = helper::map(notes.end[i] - notes.start[i], 0.f,
                                    pageSize_, 0, widthf_) -
                        padding_ * 2.f,
                   .h = noteHeight_ - padding_ * 2.f});
 
     const auto [rc, gc, bc] =
-        helper::heatmap(static_cast<float>(allNotes_.vel[i]) / 127.f);
+        helper::heatmap(static_cast<float>(notes.vel[i]) / 127.f);
     refs_.col.emplace_back(SDL_Color{.r = static_cast<uint8_t>(rc * 255.f),
                                      .g = static_cast<uint8_t>(gc * 255.f),
                                      .b = static_cast<uint8_t>(bc * 255.f),
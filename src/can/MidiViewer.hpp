@@ -2,6 +2,7 @@
 
 #include <SDL3/SDL.h>
 #include <MidiParser/Parser.hpp>
+#include <memory_resource>
 #include <string>
 #include <vector>
 
@@ -21,13 +22,25 @@ class MidiViewer : public Viewer {
   void onMouseDown(const SDL_Event& event) override;
 
  private:
-  struct {
-    std::vector<uint8_t> key;
-    std::vector<uint8_t> vel;
-    std::vector<float> start;
-    std::vector<float> end;
+  // Notes decoded from the MIDI file. Only needed until `refs_` is laid out,
+  // so the constructor backs them with an arena that is dropped afterwards.
+  struct Notes {
+    explicit Notes(std::pmr::memory_resource* mem)
+        : key(mem), vel(mem), start(mem), end(mem) {};
+    std::pmr::vector<uint8_t> key;
+    std::pmr::vector<uint8_t> vel;
+    std::pmr::vector<float> start;
+    std::pmr::vector<float> end;
     size_t size = 0;
-  } allNotes_;
+  };
+
+  // Rects paired with their fill colors.
+  struct Rects {
+    std::vector<SDL_FRect> rect;
+    std::vector<SDL_Color> col;
+    size_t size = 0;
+  };
+
   uint8_t highestKey_ = 0;
   uint8_t lowestKey_ = UINT8_MAX;
   float totalMillis_ = 0;
@@ -47,20 +60,34 @@ class MidiViewer : public Viewer {
   std::vector<SDL_FRect> gridRects_;
 
   // The collection of all midi notes represented as rects.
-  struct {
-    std::vector<SDL_FRect> rect;
-    std::vector<SDL_Color> col;
-    size_t size = 0;
-  } refs_;
+  Rects refs_;
 
-  // Updated every time `update()` is called. Filters `referenceRects_` out
-  // to only rects that are visible. Double buffered.
-  std::vector<std::pair<SDL_FRect, SDL_Color>> drawnRects_[2];
+  // Updated every time `update()` is called. Filters `refs_` out to only rects
+  // that are visible. Double buffered. Both buffers are sized to hold every
+  // note up front, so `update()` never allocates.
+  Rects drawnRects_[2];
   size_t currentBuffer = 0;
   std::vector<float> gridTicks_;
 
-  void populateNotes();
-  void populateNoteRects();
+  // Result of a pre-pass over the parsed file, used to size the load arena.
+  struct EventCounts {
+    std::vector<size_t> notesPerTrack;
+    size_t tempos = 0;
+    size_t notes = 0;
+
+    // Bytes needed to decode the file without the arena going upstream.
+    size_t arenaBytes() const;
+  };
+
+  static EventCounts countEvents(const MidiParser::MidiFile& parsed);
+
+  // Decodes `parsed` into `notes`. `notes` must be empty. On return it holds
+  // `counts.notes` entries, in track order. Scratch space and thread handles
+  // are allocated from `arena`.
+  void populateNotes(const MidiParser::MidiFile& parsed,
+                     const EventCounts& counts,
+                     std::pmr::monotonic_buffer_resource* arena, Notes& notes);
+  void populateNoteRects(const Notes& notes);
 
   // Renders `gridRects_`
   void drawPianoRoll(SDL_Renderer* renderer);